@@ -7,8 +7,10 @@
 #include "esphome/core/log.h"
 #include "esphome/core/util.h"
 
+#include <cctype>
 #include <cstdlib>
 #include <esp_http_server.h>
+#include <memory>
 #include <utility>
 
 #include "placeholder_image.h"
@@ -18,6 +20,8 @@ namespace esphome {
 namespace esp32_camera_web_server_placeholder {
 
 static const int IMAGE_REQUEST_TIMEOUT = 1000;
+static const uint32_t BURST_MAX_FRAMES = 10;
+static const uint32_t BURST_MAX_INTERVAL = 10000;
 static const char *const TAG = "camera_web_server_placeholder";
 
 #define PART_BOUNDARY "123456789000000000000987654321"
@@ -33,6 +37,13 @@ static const char *const STREAM_HEADER = "HTTP/1.0 200 OK\r\n"
 static const char *const STREAM_PART = "Content-Type: " CONTENT_TYPE "\r\n" CONTENT_LENGTH ": %u\r\n\r\n";
 static const char *const STREAM_BOUNDARY = "\r\n"
                                            "--" PART_BOUNDARY "\r\n";
+static const char *const BURST_HEADER = "HTTP/1.0 200 OK\r\n"
+                                        "Access-Control-Allow-Origin: *\r\n"
+                                        "Connection: close\r\n"
+                                        "Content-Type: multipart/mixed;boundary=" PART_BOUNDARY "\r\n"
+                                        "\r\n";
+static const char *const BURST_END = "\r\n"
+                                     "--" PART_BOUNDARY "--\r\n";
 
 CameraWebServerPlaceholder::CameraWebServerPlaceholder() {}
 
@@ -44,6 +55,7 @@ void CameraWebServerPlaceholder::setup() {
   }
 
   this->semaphore_ = xSemaphoreCreateBinary();
+  this->image_mutex_ = xSemaphoreCreateMutex();
 
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
   config.server_port = this->port_;
@@ -69,6 +81,15 @@ void CameraWebServerPlaceholder::setup() {
 
   httpd_register_uri_handler(this->httpd_, &uri);
 
+  httpd_uri_t burst_uri = {
+      .uri = "/burst",
+      .method = HTTP_GET,
+      .handler =
+          [](struct httpd_req *req) { return ((CameraWebServerPlaceholder *) req->user_ctx)->burst_handler_(req); },
+      .user_ctx = this};
+
+  httpd_register_uri_handler(this->httpd_, &burst_uri);
+
   if (camera::Camera::instance()) {
     camera::Camera::instance()->add_listener(this);
   }
@@ -76,14 +97,18 @@ void CameraWebServerPlaceholder::setup() {
 
 void CameraWebServerPlaceholder::on_camera_image(const std::shared_ptr<camera::CameraImage> &image) {
   if (this->running_ && image->was_requested_by(camera::WEB_REQUESTER)) {
-    this->image_ = image;
+    // Swap under the lock so the replaced frame is released outside of it.
+    std::shared_ptr<camera::CameraImage> previous = image;
+    xSemaphoreTake(this->image_mutex_, portMAX_DELAY);
+    this->image_.swap(previous);
+    xSemaphoreGive(this->image_mutex_);
     xSemaphoreGive(this->semaphore_);
   }
 }
 
 void CameraWebServerPlaceholder::on_shutdown() {
   this->running_ = false;
-  this->image_ = nullptr;
+  this->take_image_();
   httpd_stop(this->httpd_);
   this->httpd_ = nullptr;
   vSemaphoreDelete(this->semaphore_);
@@ -105,22 +130,82 @@ float CameraWebServerPlaceholder::get_setup_priority() const { return setup_prio
 
 void CameraWebServerPlaceholder::loop() {
   if (!this->running_) {
-    this->image_ = nullptr;
+    this->take_image_();
   }
 }
 
-std::shared_ptr<esphome::camera::CameraImage> CameraWebServerPlaceholder::wait_for_image_() {
+std::shared_ptr<esphome::camera::CameraImage> CameraWebServerPlaceholder::take_image_() {
   std::shared_ptr<esphome::camera::CameraImage> image;
+  xSemaphoreTake(this->image_mutex_, portMAX_DELAY);
   image.swap(this->image_);
+  xSemaphoreGive(this->image_mutex_);
+  return image;
+}
+
+void CameraWebServerPlaceholder::discard_image_() {
+  this->take_image_();
+  xSemaphoreTake(this->semaphore_, 0);
+}
+
+std::shared_ptr<esphome::camera::CameraImage> CameraWebServerPlaceholder::wait_for_fresh_image_() {
+  auto image = this->take_image_();
+
+  // A give left over from a frame that was already swapped out wakes us without a new
+  // image, so keep waiting until a frame is actually delivered or the timeout expires.
+  uint32_t start = millis();
+  while (!image) {
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= IMAGE_REQUEST_TIMEOUT) {
+      break;
+    }
+    TickType_t ticks = pdMS_TO_TICKS(IMAGE_REQUEST_TIMEOUT - elapsed);
+    xSemaphoreTake(this->semaphore_, ticks > 0 ? ticks : 1);
+    image = this->take_image_();
+  }
+
+  return image;
+}
+
+std::shared_ptr<esphome::camera::CameraImage> CameraWebServerPlaceholder::wait_for_image_() {
+  auto image = this->take_image_();
 
   if (!image) {
     xSemaphoreTake(this->semaphore_, IMAGE_REQUEST_TIMEOUT / portTICK_PERIOD_MS);
-    image.swap(this->image_);
+    image = this->take_image_();
   }
 
   return image;
 }
 
+static uint32_t parse_query_uint(const char *query, const char *key, uint32_t def, uint32_t min, uint32_t max) {
+  char value[12];
+  if (query == nullptr) {
+    return def;
+  }
+  esp_err_t err = httpd_query_key_value(query, key, value, sizeof(value));
+  if (err == ESP_ERR_HTTPD_RESULT_TRUNC) {
+    ESP_LOGW(TAG, "Ignoring invalid '%s' value (too long), using %" PRIu32, key, def);
+    return def;
+  }
+  if (err != ESP_OK) {
+    return def;
+  }
+  // strtoul() also accepts whitespace and a sign, so require the value to start with a digit.
+  char *end;
+  unsigned long parsed = isdigit((unsigned char) value[0]) ? strtoul(value, &end, 10) : 0;
+  if (!isdigit((unsigned char) value[0]) || *end != '\0') {
+    ESP_LOGW(TAG, "Ignoring invalid '%s' value '%s', using %" PRIu32, key, value, def);
+    return def;
+  }
+  if (parsed < min || parsed > max) {
+    uint32_t clamped = parsed < min ? min : max;
+    ESP_LOGW(TAG, "'%s' value %s out of range [%" PRIu32 ", %" PRIu32 "], using %" PRIu32, key, value, min, max,
+             clamped);
+    return clamped;
+  }
+  return (uint32_t) parsed;
+}
+
 static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len) {
   int ret;
   while (buf_len > 0) {
@@ -134,6 +219,16 @@ static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
   return ESP_OK;
 }
 
+static esp_err_t send_jpeg_part(httpd_req_t *r, const uint8_t *data, size_t length) {
+  char part_buf[64];
+  size_t hlen = snprintf(part_buf, 64, STREAM_PART, length);
+  esp_err_t res = httpd_send_all(r, part_buf, hlen);
+  if (res == ESP_OK) {
+    res = httpd_send_all(r, (const char *) data, length);
+  }
+  return res;
+}
+
 esp_err_t CameraWebServerPlaceholder::send_placeholder_(struct httpd_req *req, bool is_stream) {
   esp_err_t res = ESP_OK;
   char part_buf[64];
@@ -156,20 +251,24 @@ esp_err_t CameraWebServerPlaceholder::send_placeholder_(struct httpd_req *req, b
 esp_err_t CameraWebServerPlaceholder::handler_(struct httpd_req *req) {
   esp_err_t res = ESP_FAIL;
 
-  this->image_ = nullptr;
+  this->take_image_();
   this->running_ = true;
 
   switch (this->mode_) {
     case STREAM:
       res = this->streaming_handler_(req);
       break;
-    case SNAPSHOT:
+    case SNAPSHOT: {
+      uint32_t start = millis();
       res = this->snapshot_handler_(req);
+      this->last_snapshot_time_ = millis() - start;
+      ESP_LOGD(TAG, "SNAPSHOT: served in %" PRIu32 "ms", this->last_snapshot_time_);
       break;
+    }
   }
 
   this->running_ = false;
-  this->image_ = nullptr;
+  this->take_image_();
   return res;
 }
 
@@ -203,13 +302,7 @@ esp_err_t CameraWebServerPlaceholder::streaming_handler_(struct httpd_req *req)
         res = ESP_FAIL;
       }
     } else {
-      char part_buf[64];
-      size_t hlen = snprintf(part_buf, 64, STREAM_PART, image->get_data_length());
-      res = httpd_send_all(req, part_buf, hlen);
-      
-      if (res == ESP_OK) {
-        res = httpd_send_all(req, (const char *)image->get_data_buffer(), image->get_data_length());
-      }
+      res = send_jpeg_part(req, image->get_data_buffer(), image->get_data_length());
       if (res == ESP_OK) {
         res = httpd_send_all(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
       }
@@ -275,6 +368,116 @@ esp_err_t CameraWebServerPlaceholder::snapshot_handler_(struct httpd_req *req) {
   return res;
 }
 
+esp_err_t CameraWebServerPlaceholder::burst_handler_(struct httpd_req *req) {
+  esp_err_t res = ESP_OK;
+
+  std::unique_ptr<char[]> query;
+  size_t query_len = httpd_req_get_url_query_len(req);
+  if (query_len > 0) {
+    query.reset(new char[query_len + 1]);
+    if (httpd_req_get_url_query_str(req, query.get(), query_len + 1) != ESP_OK) {
+      ESP_LOGW(TAG, "BURST: failed to read query string, using defaults");
+      query.reset();
+    }
+  }
+  uint32_t count = parse_query_uint(query.get(), "n", 1, 1, BURST_MAX_FRAMES);
+  uint32_t interval = parse_query_uint(query.get(), "interval", 0, 0, BURST_MAX_INTERVAL);
+
+  // Drop any frame (and its pending give) left over from an earlier request, so every
+  // part of the burst comes from a capture made after the burst started.
+  this->discard_image_();
+  this->running_ = true;
+
+  // Keep the camera streaming for the whole burst so frame i+1 is captured while
+  // frame i is being sent, instead of a separate request_image() round trip per frame.
+  bool camera_ok = camera::Camera::instance() && !camera::Camera::instance()->is_failed();
+  if (camera_ok) {
+    camera::Camera::instance()->start_stream(esphome::camera::WEB_REQUESTER);
+  }
+
+  uint32_t start = millis();
+  uint32_t last_frame = start;
+  uint32_t frames = 0;
+  uint32_t placeholder_frames = 0;
+
+  for (uint32_t i = 0; i < count && res == ESP_OK && this->running_; i++) {
+    if (i > 0 && interval > 0) {
+      uint32_t elapsed = millis() - last_frame;
+      if (elapsed < interval) {
+        delay(interval - elapsed);
+      }
+      // Drop whatever arrived during the wait so the next part is a fresh frame.
+      this->discard_image_();
+    }
+
+    auto image = this->wait_for_fresh_image_();
+    last_frame = millis();
+
+    const uint8_t *data;
+    size_t length;
+    if (image) {
+      // The frame buffer is sent in place; the shared_ptr keeps it alive until it is on the wire.
+      data = image->get_data_buffer();
+      length = image->get_data_length();
+      frames++;
+    } else if (this->placeholder_enabled_) {
+      ESP_LOGD(TAG, "BURST: serving placeholder frame");
+      data = PLACEHOLDER_JPEG;
+      length = PLACEHOLDER_JPEG_SIZE;
+      placeholder_frames++;
+    } else if (i == 0) {
+      ESP_LOGW(TAG, "BURST: no frame available");
+      httpd_resp_send_500(req);
+      res = ESP_FAIL;
+      break;
+    } else {
+      ESP_LOGW(TAG, "BURST: no frame available, ending burst after %" PRIu32 " frames", i);
+      httpd_send_all(req, BURST_END, strlen(BURST_END));
+      res = ESP_FAIL;
+      break;
+    }
+
+    if (i == 0) {
+      res = httpd_send_all(req, BURST_HEADER, strlen(BURST_HEADER));
+      if (res != ESP_OK) {
+        ESP_LOGW(TAG, "BURST: failed to set HTTP header");
+        break;
+      }
+    }
+
+    // Each part is preceded by its delimiter, so the body can be closed with BURST_END at any point.
+    res = httpd_send_all(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
+    if (res == ESP_OK) {
+      res = send_jpeg_part(req, data, length);
+    }
+  }
+
+  if (res == ESP_OK) {
+    res = httpd_send_all(req, BURST_END, strlen(BURST_END));
+  }
+
+  if (camera_ok) {
+    camera::Camera::instance()->stop_stream(esphome::camera::WEB_REQUESTER);
+  }
+
+  this->running_ = false;
+  this->take_image_();
+
+  uint32_t total = millis() - start;
+  uint32_t sent = frames + placeholder_frames;
+  ESP_LOGI(TAG, "BURST: %" PRIu32 "/%" PRIu32 " frames (%" PRIu32 " placeholder) in %" PRIu32 "ms, %" PRIu32 "ms/frame",
+           sent, count, placeholder_frames, total, sent > 0 ? total / sent : 0);
+  if (this->last_snapshot_time_ > 0) {
+    ESP_LOGI(TAG, "BURST: %" PRIu32 " snapshots would take ~%" PRIu32 "ms (last snapshot: %" PRIu32 "ms)", count,
+             count * this->last_snapshot_time_, this->last_snapshot_time_);
+  } else {
+    ESP_LOGI(TAG, "BURST: %" PRIu32 " snapshots would take up to %" PRIu32 "ms (%d ms timeout each)", count,
+             count * IMAGE_REQUEST_TIMEOUT, IMAGE_REQUEST_TIMEOUT);
+  }
+
+  return res;
+}
+
 }
 }
 
@@ -34,17 +34,23 @@ class CameraWebServerPlaceholder : public Component, public camera::CameraListen
   void on_camera_image(const std::shared_ptr<camera::CameraImage> &image) override;
 
  protected:
+  std::shared_ptr<camera::CameraImage> take_image_();
   std::shared_ptr<camera::CameraImage> wait_for_image_();
+  std::shared_ptr<camera::CameraImage> wait_for_fresh_image_();
+  void discard_image_();
   esp_err_t handler_(struct httpd_req *req);
   esp_err_t streaming_handler_(struct httpd_req *req);
   esp_err_t snapshot_handler_(struct httpd_req *req);
+  esp_err_t burst_handler_(struct httpd_req *req);
   esp_err_t send_placeholder_(struct httpd_req *req, bool is_stream);
 
   uint16_t port_{0};
   void *httpd_{nullptr};
   SemaphoreHandle_t semaphore_;
+  SemaphoreHandle_t image_mutex_{nullptr};
   std::shared_ptr<camera::CameraImage> image_;
   bool running_{false};
+  uint32_t last_snapshot_time_{0};
   bool placeholder_enabled_{true};
   Mode mode_{STREAM};
 };